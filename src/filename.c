@@ -539,6 +539,50 @@ error:
     goto out;
 }
 
+/*
+ * Returns TRUE if the file exists and contains exactly the given
+ * bytes, which is used to avoid rewriting output files which
+ * wouldn't change.
+ */
+gboolean
+file_has_contents(const char *filename, const char *data, size_t len)
+{
+    int fd;
+    struct stat sb;
+    gboolean same = FALSE;
+    char buf[4096];
+
+    if ((fd = open(filename, O_RDONLY)) < 0)
+	return FALSE;
+    if (fstat(fd, &sb) < 0 || !S_ISREG(sb.st_mode) || (size_t)sb.st_size != len)
+	goto out;
+    while (len > 0)
+    {
+	int n = read(fd, buf, (len < sizeof(buf) ? len : sizeof(buf)));
+	if (n <= 0 || memcmp(buf, data, n))
+	    goto out;
+	data += n;
+	len -= n;
+    }
+    same = TRUE;
+out:
+    close(fd);
+    return same;
+}
+
+gboolean
+file_same_contents(const char *filename1, const char *filename2)
+{
+    char *data = 0;
+    gsize len = 0;
+
+    if (!g_file_get_contents(filename1, &data, &len, 0))
+	return FALSE;
+    gboolean same = file_has_contents(filename2, data, len);
+    g_free(data);
+    return same;
+}
+
 /*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
 
 char *file_temp_directory(const char *prefix)
@@ -45,6 +45,8 @@ int file_is_directory(const char *filename);
 char *file_join2(const char *part1, const char *part2);
 char *file_join(const char *part, ...);
 int file_copy(const char *filefrom, const char *fileto);
+gboolean file_has_contents(const char *filename, const char *data, size_t len);
+gboolean file_same_contents(const char *filename1, const char *filename2);
 char *file_temp_directory(const char *prefix);
 
 #endif /* _ggcov_filename_h_ */
@@ -26,11 +26,11 @@
 #include "filename.h"
 #include "estring.H"
 #include "filerec.H"
-#include "yaml_generator.H"
 #include "mustache.H"
 #include "flow_diagram.H"
 #include "libgd_scenegen.H"
 #include "unique_ptr.H"
+#include "thread_pool.H"
 #include "logging.H"
 
 char *argv0;
@@ -46,6 +46,7 @@ public:
 
     ARGPARSE_STRING_PROPERTY(output_directory);
     ARGPARSE_STRING_PROPERTY(template_directory);
+    ARGPARSE_BOOL_PROPERTY(incremental);
 
 public:
     void setup_parser(argparse::parser_t &parser)
@@ -65,6 +66,9 @@ public:
 	      .description(t_desc)
 	      .setter((argparse::arg_setter_t)&gghtml_params_t::set_template_directory)
               .metavar("DIR");
+	parser.add_option(0, "incremental")
+	      .description("only rewrite pages and diagrams which have changed since the last run")
+	      .setter((argparse::noarg_setter_t)&gghtml_params_t::set_incremental);
 	parser.set_other_option_help("[OPTIONS] [executable|source|directory]...");
     }
 
@@ -77,6 +81,7 @@ public:
 	{
 	    dump_log.debug2("output_directory=\"%s\"\n", output_directory_.data());
 	    dump_log.debug2("template_directory=\"%s\"\n", template_directory_.data());
+	    dump_log.debug2("incremental=%d\n", incremental_);
 	    dump_log.debug2("data_directory=\"%s\"\n", data_directory_.data());
 	}
     }
@@ -86,6 +91,7 @@ private:
 
 gghtml_params_t::gghtml_params_t(const char *argv0)
  :  output_directory_("html"),
+    incremental_(false),
     data_directory_(PKGDATADIR)
 {
     /*
@@ -160,6 +166,11 @@ generate_static_files(const gghtml_params_t &params)
 
 	string_var filefrom = file_join2(params.get_template_directory(), p);
 	string_var fileto = file_join2(params.get_output_directory(), p);
+	if (params.get_incremental() && file_same_contents(filefrom, fileto))
+	{
+	    _log.debug("Static file %s is unchanged\n", fileto.data());
+	    continue;
+	}
 	_log.info("Installing static file %s to %s\n", filefrom.data(), fileto.data());
 	if (file_copy(filefrom, fileto) < 0)
 	{
@@ -196,62 +207,62 @@ source_url(const cov_location_t *loc)
 /*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
 
 static void
-generate_stats(yaml_generator_t &yaml, const cov_stats_t &stats)
+generate_stats(mustache::generator_t &data, const cov_stats_t &stats)
 {
     estring absbuf, pcbuf;
 
-    yaml.begin_mapping();
+    data.begin_mapping();
 
-    yaml.key("blocks_executed").value((uint64_t)stats.blocks_executed());
-    yaml.key("blocks_total").value((uint64_t)stats.blocks_total());
-    yaml.key("blocks_fraction").value(stats.blocks_fraction());
-    yaml.key("blocks_percent").value((unsigned)(100.0*stats.blocks_fraction()+0.5));
-    yaml.key("blocks_sort_fraction").value(stats.blocks_sort_fraction());
-    yaml.key("blocks_sort_percent").value((unsigned)(100.0*stats.blocks_sort_fraction()+0.5));
+    data.key("blocks_executed").value((uint64_t)stats.blocks_executed());
+    data.key("blocks_total").value((uint64_t)stats.blocks_total());
+    data.key("blocks_fraction").value(stats.blocks_fraction());
+    data.key("blocks_percent").value((unsigned)(100.0*stats.blocks_fraction()+0.5));
+    data.key("blocks_sort_fraction").value(stats.blocks_sort_fraction());
+    data.key("blocks_sort_percent").value((unsigned)(100.0*stats.blocks_sort_fraction()+0.5));
     cov_stats_t::format_row_labels(stats.blocks_by_status(), absbuf, pcbuf);
-    yaml.key("blocks_abslabel").value(absbuf);
-    yaml.key("blocks_pclabel").value(pcbuf);
-
-    yaml.key("lines_executed").value((uint64_t)stats.lines_executed());
-    yaml.key("lines_full").value((uint64_t)stats.lines_full());
-    yaml.key("lines_partial").value((uint64_t)stats.lines_partial());
-    yaml.key("lines_total").value((uint64_t)stats.lines_total());
-    yaml.key("lines_fraction").value(stats.lines_fraction());
-    yaml.key("lines_sort_fraction").value(stats.lines_sort_fraction());
+    data.key("blocks_abslabel").value(absbuf);
+    data.key("blocks_pclabel").value(pcbuf);
+
+    data.key("lines_executed").value((uint64_t)stats.lines_executed());
+    data.key("lines_full").value((uint64_t)stats.lines_full());
+    data.key("lines_partial").value((uint64_t)stats.lines_partial());
+    data.key("lines_total").value((uint64_t)stats.lines_total());
+    data.key("lines_fraction").value(stats.lines_fraction());
+    data.key("lines_sort_fraction").value(stats.lines_sort_fraction());
     cov_stats_t::format_row_labels(stats.lines_by_status(), absbuf, pcbuf);
-    yaml.key("lines_abslabel").value(absbuf);
-    yaml.key("lines_pclabel").value(pcbuf);
-
-    yaml.key("functions_executed").value((uint64_t)stats.functions_executed());
-    yaml.key("functions_full").value((uint64_t)stats.functions_full());
-    yaml.key("functions_partial").value((uint64_t)stats.functions_partial());
-    yaml.key("functions_total").value((uint64_t)stats.functions_total());
-    yaml.key("functions_fraction").value(stats.functions_fraction());
-    yaml.key("functions_sort_fraction").value(stats.functions_sort_fraction());
+    data.key("lines_abslabel").value(absbuf);
+    data.key("lines_pclabel").value(pcbuf);
+
+    data.key("functions_executed").value((uint64_t)stats.functions_executed());
+    data.key("functions_full").value((uint64_t)stats.functions_full());
+    data.key("functions_partial").value((uint64_t)stats.functions_partial());
+    data.key("functions_total").value((uint64_t)stats.functions_total());
+    data.key("functions_fraction").value(stats.functions_fraction());
+    data.key("functions_sort_fraction").value(stats.functions_sort_fraction());
     cov_stats_t::format_row_labels(stats.functions_by_status(), absbuf, pcbuf);
-    yaml.key("functions_abslabel").value(absbuf);
-    yaml.key("functions_pclabel").value(pcbuf);
+    data.key("functions_abslabel").value(absbuf);
+    data.key("functions_pclabel").value(pcbuf);
 
-    yaml.key("calls_executed").value((uint64_t)stats.calls_executed());
-    yaml.key("calls_total").value((uint64_t)stats.calls_total());
-    yaml.key("calls_fraction").value(stats.calls_fraction());
-    yaml.key("calls_sort_fraction").value(stats.calls_sort_fraction());
+    data.key("calls_executed").value((uint64_t)stats.calls_executed());
+    data.key("calls_total").value((uint64_t)stats.calls_total());
+    data.key("calls_fraction").value(stats.calls_fraction());
+    data.key("calls_sort_fraction").value(stats.calls_sort_fraction());
     cov_stats_t::format_row_labels(stats.calls_by_status(), absbuf, pcbuf);
-    yaml.key("calls_abslabel").value(absbuf);
-    yaml.key("calls_pclabel").value(pcbuf);
-
-    yaml.key("branches_executed").value((uint64_t)stats.branches_executed());
-    yaml.key("branches_taken").value((uint64_t)stats.branches_taken());
-    yaml.key("branches_total").value((uint64_t)stats.branches_total());
-    yaml.key("branches_fraction").value(stats.branches_fraction());
-    yaml.key("branches_sort_fraction").value(stats.branches_sort_fraction());
+    data.key("calls_abslabel").value(absbuf);
+    data.key("calls_pclabel").value(pcbuf);
+
+    data.key("branches_executed").value((uint64_t)stats.branches_executed());
+    data.key("branches_taken").value((uint64_t)stats.branches_taken());
+    data.key("branches_total").value((uint64_t)stats.branches_total());
+    data.key("branches_fraction").value(stats.branches_fraction());
+    data.key("branches_sort_fraction").value(stats.branches_sort_fraction());
     cov_stats_t::format_row_labels(stats.branches_by_status(), absbuf, pcbuf);
-    yaml.key("branches_abslabel").value(absbuf);
-    yaml.key("branches_pclabel").value(pcbuf);
+    data.key("branches_abslabel").value(absbuf);
+    data.key("branches_pclabel").value(pcbuf);
 
-    yaml.key("status_by_blocks").value(cov::short_name(stats.status_by_blocks()));
-    yaml.key("status_by_lines").value(cov::short_name(stats.status_by_lines()));
-    yaml.end_mapping();
+    data.key("status_by_blocks").value(cov::short_name(stats.status_by_blocks()));
+    data.key("status_by_lines").value(cov::short_name(stats.status_by_lines()));
+    data.end_mapping();
 }
 
 /*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
@@ -260,59 +271,59 @@ static void
 generate_index(const gghtml_params_t &params)
 {
     unique_ptr<mustache::template_t> tmpl = menv.make_template("index.html");
-    yaml_generator_t &yaml = tmpl->begin_render();
+    mustache::generator_t &data = tmpl->begin_render();
 
     cov_overall_scope_t scope;
 
-    yaml.begin_mapping();
-    yaml.key("subtitle").value("summary");
-    yaml.key("stats"); generate_stats(yaml, *scope.get_stats());
-    yaml.end_mapping();
+    data.begin_mapping();
+    data.key("subtitle").value("summary");
+    data.key("stats"); generate_stats(data, *scope.get_stats());
+    data.end_mapping();
 
     tmpl->end_render();
 }
 
 /*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
 
-static void generate_tree_node(file_rec_t *fr, yaml_generator_t &yaml, unsigned int depth)
+static void generate_tree_node(file_rec_t *fr, mustache::generator_t &data, unsigned int depth)
 {
     if (depth)
     {
 	cov_file_t *f = fr->get_file();
-	yaml.begin_mapping();
-	yaml.key("name").value(file_basename_c(fr->get_name()));
-	yaml.key("status").value(cov::short_name(fr->get_scope()->status()));
-	yaml.key("is_file?").bool_value(fr->is_file());
+	data.begin_mapping();
+	data.key("name").value(file_basename_c(fr->get_name()));
+	data.key("status").value(cov::short_name(fr->get_scope()->status()));
+	data.key("is_file?").bool_value(fr->is_file());
 	if (fr->is_file())
 	{
 	    string_var url = source_url(f);
-	    yaml.key("url").value(url);
-	    yaml.key("minimal_name").value(f->minimal_name());
+	    data.key("url").value(url);
+	    data.key("minimal_name").value(f->minimal_name());
 	}
-	yaml.key("indent").value(4*(depth-1));
-	yaml.key("stats"); generate_stats(yaml, *fr->get_scope()->get_stats());
-	yaml.end_mapping();
+	data.key("indent").value(4*(depth-1));
+	data.key("stats"); generate_stats(data, *fr->get_scope()->get_stats());
+	data.end_mapping();
     }
 
     for (list_iterator_t<file_rec_t> friter = fr->first_child() ; *friter ; ++friter)
-	generate_tree_node(*friter, yaml, depth+1);
+	generate_tree_node(*friter, data, depth+1);
 }
 
 static void
 generate_source_tree(const gghtml_params_t &params)
 {
     unique_ptr<mustache::template_t> tmpl = menv.make_template("tree.html");
-    yaml_generator_t &yaml = tmpl->begin_render();
+    mustache::generator_t &data = tmpl->begin_render();
 
     unique_ptr<file_rec_t> tree = new file_rec_t("", 0);
     tree->add_descendents(cov_file_t::first());
 
-    yaml.begin_mapping();
-    yaml.key("subtitle").value("source tree");
-    yaml.key("files").begin_sequence();
-    generate_tree_node(tree.get(), yaml, 0U);
-    yaml.end_sequence();
-    yaml.end_mapping();
+    data.begin_mapping();
+    data.key("subtitle").value("source tree");
+    data.key("files").begin_sequence();
+    generate_tree_node(tree.get(), data, 0U);
+    data.end_sequence();
+    data.end_mapping();
 
     tmpl->end_render();
 }
@@ -341,6 +352,19 @@ static void set_diagram_colors(diagram_t *di)
     di->set_bg(cov::SUPPRESSED, 0x8080d0);
 }
 
+/*
+ * Diagrams are named for the file and the function's index in it,
+ * so the names don't depend on the order pages are generated in.
+ */
+static char *
+flow_diagram_name(const cov_function_t *fn)
+{
+    estring nm(fn->file()->minimal_name());
+    nm.replace_all("/", "_");
+    nm.append_printf(".flow%u.png", fn->findex());
+    return nm.take();
+}
+
 static flow_t *generate_flow_diagram(const gghtml_params_t &params, cov_function_t *fn)
 {
     unique_ptr<diagram_t> diag = new flow_diagram_t(fn);
@@ -354,8 +378,7 @@ static flow_t *generate_flow_diagram(const gghtml_params_t &params, cov_function
     unique_ptr<libgd_scenegen_t> sg = new libgd_scenegen_t(width, height, bounds);
     diag->render(sg.get());
 
-    static unsigned int tag = 1;
-    string_var name = g_strdup_printf("flow%u.png", tag++);
+    string_var name = flow_diagram_name(fn);
     string_var path = file_join2(params.get_output_directory(), name);
     _log.info("Generating flow diagram %s for function %s file %s\n",
 	    name.data(), fn->name(), fn->file()->minimal_name());
@@ -402,27 +425,27 @@ generate_annotated_source(const gghtml_params_t &params, cov_file_t *f,
      */
     unsigned int lines_left = 0;
     unique_ptr<mustache::template_t> tmpl = menv.make_template("source.html", out_name);
-    yaml_generator_t &yaml = tmpl->begin_render();
+    mustache::generator_t &data = tmpl->begin_render();
 
-    yaml.begin_mapping();
+    data.begin_mapping();
     string_var subtitle = g_strdup_printf("source %s", f->minimal_name());
-    yaml.key("subtitle").value(subtitle);
-    yaml.key("filename").value(f->name());
-    yaml.key("minimal_name").value(f->minimal_name());
-    yaml.key("lines").begin_sequence();
+    data.key("subtitle").value(subtitle);
+    data.key("filename").value(f->name());
+    data.key("minimal_name").value(f->minimal_name());
+    data.key("lines").begin_sequence();
     while (annotator.next())
     {
-	yaml.begin_mapping();
-	yaml.key("status_short").value(cov::short_name(annotator.status()));
-	yaml.key("status_long").value(cov::long_name(annotator.status()));
-	yaml.key("count").value(annotator.count());
-	yaml.key("count_if_instrumented").value(annotator.count_as_string());
-	yaml.key("lineno").value((unsigned int)annotator.lineno());
-	yaml.key("blocks").value(annotator.blocks_as_string());
-	yaml.key("text").value(annotator.text());
+	data.begin_mapping();
+	data.key("status_short").value(cov::short_name(annotator.status()));
+	data.key("status_long").value(cov::long_name(annotator.status()));
+	data.key("count").value(annotator.count());
+	data.key("count_if_instrumented").value(annotator.count_as_string());
+	data.key("lineno").value((unsigned int)annotator.lineno());
+	data.key("blocks").value(annotator.blocks_as_string());
+	data.key("text").value(annotator.text());
         const char *stext = annotator.suppression_text();
         if (stext)
-            yaml.key("suppression_text").value(stext);
+            data.key("suppression_text").value(stext);
 
         if (annotator.is_first_line_in_function())
         {
@@ -431,24 +454,24 @@ generate_annotated_source(const gghtml_params_t &params, cov_file_t *f,
 	    if (flow)
 	    {
                 lines_left = fn->get_num_lines();
-		yaml.key("flow_diagram").begin_mapping();
-		yaml.key("nlines").value(fn->get_num_lines());
+		data.key("flow_diagram").begin_mapping();
+		data.key("nlines").value(fn->get_num_lines());
 		double sf = 0.445;
-		yaml.key("width").value((unsigned int)(sf * flow->width + 0.5));
-		yaml.key("height").value((unsigned int)(sf * flow->height + 0.5));
-		yaml.key("url").value(flow->url);
-		yaml.end_mapping();
+		data.key("width").value((unsigned int)(sf * flow->width + 0.5));
+		data.key("height").value((unsigned int)(sf * flow->height + 0.5));
+		data.key("url").value(flow->url);
+		data.end_mapping();
 	    }
 	}
 	if (!lines_left)
-	    yaml.key("flow_filler").bool_value(true);
+	    data.key("flow_filler").bool_value(true);
         if (lines_left)
             lines_left--;
 
-	yaml.end_mapping();
+	data.end_mapping();
     }
-    yaml.end_sequence();
-    yaml.end_mapping();
+    data.end_sequence();
+    data.end_mapping();
 
     tmpl->end_render();
 }
@@ -459,11 +482,11 @@ static void
 generate_functions(const gghtml_params_t &params)
 {
     unique_ptr<mustache::template_t> tmpl = menv.make_template("functions.html");
-    yaml_generator_t &yaml = tmpl->begin_render();
+    mustache::generator_t &data = tmpl->begin_render();
 
-    yaml.begin_mapping();
-    yaml.key("subtitle").value("functions");
-    yaml.key("functions").begin_sequence();
+    data.begin_mapping();
+    data.key("subtitle").value("functions");
+    data.key("functions").begin_sequence();
     for (list_iterator_t<cov_file_t> iter = cov_file_t::first() ; *iter ; ++iter)
     {
 	for (ptrarray_iterator_t<cov_function_t> fnitr = (*iter)->functions().first() ; *fnitr ; ++fnitr)
@@ -477,18 +500,18 @@ generate_functions(const gghtml_params_t &params)
             if (!loc)
                 continue;
 	    string_var url = source_url(loc);
-	    yaml.begin_mapping();
-	    yaml.key("name").value(fn->name());
-	    yaml.key("url").value(url);
-	    yaml.key("status").value(cov::short_name(st));
-	    yaml.key("filename").value(loc->filename);
-	    yaml.key("lineno").value((unsigned int)loc->lineno);
-	    yaml.key("stats"); generate_stats(yaml, stats);
-	    yaml.end_mapping();
+	    data.begin_mapping();
+	    data.key("name").value(fn->name());
+	    data.key("url").value(url);
+	    data.key("status").value(cov::short_name(st));
+	    data.key("filename").value(loc->filename);
+	    data.key("lineno").value((unsigned int)loc->lineno);
+	    data.key("stats"); generate_stats(data, stats);
+	    data.end_mapping();
 	}
     }
-    yaml.end_sequence();
-    yaml.end_mapping();
+    data.end_sequence();
+    data.end_mapping();
 
     tmpl->end_render();
 }
@@ -502,6 +525,445 @@ delete_one_flow(void *key, flow_t *value, void *closure)
     return TRUE;    /* remove from hashtable */
 }
 
+/*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
+/*
+ * The output directory contains a manifest which records, for each
+ * annotated source page, a hash of everything the page and its flow
+ * diagrams are generated from, and the names of the diagrams.  With
+ * --incremental, a page whose hash hasn't changed since the last run
+ * isn't generated again, and pages and diagrams which the last run
+ * wrote but this one didn't are deleted.  The manifest looks like
+ *
+ * ggcov-html manifest 1
+ * page HASH NAME
+ * diagram NAME
+ * ...
+ *
+ * where each diagram belongs to the page before it.
+ */
+
+static const char manifest_name[] = ".ggcov-manifest";
+static const char manifest_magic[] = "ggcov-html manifest 1";
+
+struct page_record_t
+{
+    page_record_t(const char *name, const char *hash)
+     :  name_(name),
+	hash_(hash)
+    {
+    }
+
+    gboolean has_diagram(const char *name) const
+    {
+	for (unsigned int i = 0 ; i < diagrams_.size() ; i++)
+	    if (diagrams_[i] == name)
+		return TRUE;
+	return FALSE;
+    }
+
+    string_var name_;
+    string_var hash_;
+    std::vector<std::string> diagrams_;
+};
+
+class html_manifest_t
+{
+public:
+    html_manifest_t(const char *directory);
+    ~html_manifest_t();
+
+    void load();
+    gboolean save();
+
+    /* Returns the last run's record for the page, if it has the
+     * same hash and its output files are all still there */
+    const page_record_t *find_unchanged(const char *name, const char *hash) const;
+    /* Record a page generated, or left unchanged, by this run */
+    void add(page_record_t *);
+    /* Delete output files which only the last run generated */
+    void remove_stale();
+
+private:
+    void remove_output(const char *name);
+
+    string_var directory_;
+    string_var filename_;
+    hashtable_t<const char, page_record_t> *previous_;
+    list_t<page_record_t> previous_list_;
+    hashtable_t<const char, page_record_t> *current_;
+    list_t<page_record_t> current_list_;
+};
+
+html_manifest_t::html_manifest_t(const char *directory)
+ :  directory_(directory),
+    filename_(file_join2(directory, manifest_name)),
+    previous_(new hashtable_t<const char, page_record_t>),
+    current_(new hashtable_t<const char, page_record_t>)
+{
+}
+
+html_manifest_t::~html_manifest_t()
+{
+    delete previous_;
+    previous_list_.delete_all();
+    delete current_;
+    current_list_.delete_all();
+}
+
+void
+html_manifest_t::load()
+{
+    FILE *fp;
+    char buf[4096];
+    char *p;
+    unsigned int lineno = 0;
+    page_record_t *rec = 0;
+
+    if ((fp = fopen(filename_, "r")) == 0)
+    {
+	if (errno != ENOENT)
+	    perror(filename_);
+	return;
+    }
+
+    while ((fgets(buf, sizeof(buf), fp)) != 0)
+    {
+	lineno++;
+	/* trim trailing whitespace */
+	p = buf+strlen(buf);
+	while (p > buf && isspace(p[-1]))
+	    *--p = '\0';
+
+	if (lineno == 1)
+	{
+	    if (strcmp(buf, manifest_magic))
+	    {
+		_log.warning("%s: not a manifest, ignoring\n", filename_.data());
+		break;
+	    }
+	}
+	else if (!strncmp(buf, "page ", 5) && (p = strchr(buf+5, ' ')) != 0)
+	{
+	    *p++ = '\0';
+	    if (previous_->lookup(p))
+		continue;
+	    rec = new page_record_t(p, buf+5);
+	    previous_->insert(rec->name_, rec);
+	    previous_list_.append(rec);
+	}
+	else if (!strncmp(buf, "diagram ", 8) && rec)
+	{
+	    rec->diagrams_.push_back(buf+8);
+	}
+	else
+	{
+	    _log.warning("%s:%u: bad manifest line, ignoring\n",
+			 filename_.data(), lineno);
+	}
+    }
+    fclose(fp);
+    _log.debug("Read manifest %s with %u pages\n",
+	       filename_.data(), previous_->size());
+}
+
+gboolean
+html_manifest_t::save()
+{
+    estring buf;
+
+    buf.append_printf("%s\n", manifest_magic);
+    for (list_iterator_t<page_record_t> iter = current_list_.first() ; *iter ; ++iter)
+    {
+	const page_record_t *rec = *iter;
+	buf.append_printf("page %s %s\n", rec->hash_.data(), rec->name_.data());
+	for (unsigned int i = 0 ; i < rec->diagrams_.size() ; i++)
+	    buf.append_printf("diagram %s\n", rec->diagrams_[i].c_str());
+    }
+
+    if (file_has_contents(filename_, buf.data(), buf.length()))
+	return TRUE;
+
+    /* write a new file and rename, so a crash can't leave it half written */
+    string_var tmpfile = g_strconcat(filename_.data(), ".NEW", (const char *)0);
+    GError *error = 0;
+    if (!g_file_set_contents(tmpfile, buf.data(), buf.length(), &error) ||
+	rename(tmpfile, filename_) < 0)
+    {
+	_log.error("%s: %s\n", filename_.data(),
+		   (error ? error->message : strerror(errno)));
+	if (error)
+	    g_error_free(error);
+	unlink(tmpfile);
+	return FALSE;
+    }
+    return TRUE;
+}
+
+const page_record_t *
+html_manifest_t::find_unchanged(const char *name, const char *hash) const
+{
+    const page_record_t *rec = previous_->lookup(name);
+    if (rec == 0 || strcmp(rec->hash_, hash))
+	return 0;
+
+    string_var path = file_join2(directory_, name);
+    if (file_is_regular(path) < 0)
+	return 0;
+    for (unsigned int i = 0 ; i < rec->diagrams_.size() ; i++)
+    {
+	path = file_join2(directory_, rec->diagrams_[i].c_str());
+	if (file_is_regular(path) < 0)
+	    return 0;
+    }
+    return rec;
+}
+
+void
+html_manifest_t::add(page_record_t *rec)
+{
+    current_->insert(rec->name_, rec);
+    current_list_.append(rec);
+}
+
+void
+html_manifest_t::remove_output(const char *name)
+{
+    string_var path = file_join2(directory_, name);
+    _log.info("Removing stale file %s\n", path.data());
+    if (unlink(path) < 0 && errno != ENOENT)
+	perror(path);
+}
+
+void
+html_manifest_t::remove_stale()
+{
+    for (list_iterator_t<page_record_t> iter = previous_list_.first() ; *iter ; ++iter)
+    {
+	const page_record_t *prev = *iter;
+	const page_record_t *curr = current_->lookup(prev->name_);
+	if (curr == 0)
+	    remove_output(prev->name_);
+	for (unsigned int i = 0 ; i < prev->diagrams_.size() ; i++)
+	{
+	    if (curr == 0 || !curr->has_diagram(prev->diagrams_[i].c_str()))
+		remove_output(prev->diagrams_[i].c_str());
+	}
+    }
+}
+
+/*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
+
+static void
+hash_string(GChecksum *sum, const char *s)
+{
+    if (s == 0)
+	s = "";
+    /* include the nul so adjacent strings can't run together */
+    g_checksum_update(sum, (const guchar *)s, strlen(s)+1);
+}
+
+static void
+hash_number(GChecksum *sum, uint64_t u)
+{
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%llu", (unsigned long long)u);
+    hash_string(sum, buf);
+}
+
+/*
+ * The version of the source page template and of the code which
+ * expands it and draws the diagrams.
+ */
+static char *
+source_template_hash(const gghtml_params_t &params)
+{
+    GChecksum *sum = g_checksum_new(G_CHECKSUM_SHA1);
+    hash_string(sum, VERSION);
+
+    string_var path = file_join2(params.get_template_directory(), "source.html");
+    char *text = 0;
+    gsize len = 0;
+    if (g_file_get_contents(path, &text, &len, 0))
+    {
+	g_checksum_update(sum, (const guchar *)text, len);
+	g_free(text);
+    }
+
+    char *hash = g_strdup(g_checksum_get_string(sum));
+    g_checksum_free(sum);
+    return hash;
+}
+
+/*
+ * Hash everything which goes into the source page for a file and
+ * into its flow diagrams: the source text, the line and block counts
+ * and status, suppressions, and the shape of the functions' flow
+ * graphs.
+ */
+static char *
+source_page_hash(cov_file_t *f, const char *template_hash)
+{
+    GChecksum *sum = g_checksum_new(G_CHECKSUM_SHA1);
+    hash_string(sum, template_hash);
+    hash_string(sum, f->name());
+    hash_string(sum, f->minimal_name());
+
+    cov_file_annotator_t annotator(f);
+    while (annotator.is_valid() && annotator.next())
+    {
+	hash_string(sum, cov::short_name(annotator.status()));
+	hash_number(sum, annotator.count());
+	hash_string(sum, annotator.count_as_string());
+	hash_string(sum, annotator.blocks_as_string());
+	hash_string(sum, annotator.text());
+	hash_string(sum, annotator.suppression_text());
+    }
+
+    for (unsigned int i = 0 ; i < f->num_functions() ; i++)
+    {
+	cov_function_t *fn = f->nth_function(i);
+	hash_string(sum, fn->name());
+	hash_number(sum, fn->get_num_lines());
+	for (ptrarray_iterator_t<cov_block_t> bitr = fn->blocks().first() ; *bitr ; ++bitr)
+	{
+	    cov_block_t *b = *bitr;
+	    hash_number(sum, b->bindex());
+	    hash_string(sum, cov::short_name(b->status()));
+	    hash_number(sum, b->count());
+	    for (unsigned int i = 0 ; i < b->num_locations() ; i++)
+	    {
+		hash_string(sum, b->nth_location(i)->filename);
+		hash_number(sum, b->nth_location(i)->lineno);
+	    }
+	    for (list_iterator_t<cov_arc_t> aiter = b->first_arc() ; *aiter ; ++aiter)
+	    {
+		hash_number(sum, (*aiter)->to()->bindex());
+		hash_string(sum, cov::short_name((*aiter)->status()));
+	    }
+	}
+    }
+
+    char *hash = g_strdup(g_checksum_get_string(sum));
+    g_checksum_free(sum);
+    return hash;
+}
+
+/*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
+
+/*
+ * A source file's flow diagrams and annotated source page only
+ * read the model and write their own output files, so with --jobs
+ * they're generated for several files at once on a thread pool.
+ */
+class source_page_job_t : public thread_pool_t::job_t
+{
+public:
+    source_page_job_t(const gghtml_params_t &params,
+		      const html_manifest_t &manifest,
+		      const char *template_hash,
+		      cov_file_t *f)
+     :  params_(params),
+	manifest_(manifest),
+	template_hash_(template_hash),
+	file_(f),
+	record_(0)
+    {
+    }
+
+    ~source_page_job_t()
+    {
+	delete record_;
+    }
+
+    void run()
+    {
+	string_var name = source_url(file_);
+	string_var hash = source_page_hash(file_, template_hash_);
+	record_ = new page_record_t(name, hash);
+
+	const page_record_t *prev;
+	if (params_.get_incremental() &&
+	    (prev = manifest_.find_unchanged(name, hash)) != 0)
+	{
+	    _log.info("Source page %s is unchanged\n", name.data());
+	    record_->diagrams_ = prev->diagrams_;
+	    return;
+	}
+
+	hashtable_t<void, flow_t> *flows = generate_flow_diagrams(params_, file_);
+	for (unsigned int i = 0 ; i < file_->num_functions() ; i++)
+	{
+	    flow_t *flow = flows->lookup((void *)file_->nth_function(i));
+	    if (flow)
+		record_->diagrams_.push_back(flow->url.data());
+	}
+	generate_annotated_source(params_, file_, flows);
+	flows->foreach_remove(delete_one_flow, 0);
+	delete flows;
+    }
+
+    page_record_t *take_record()
+    {
+	page_record_t *rec = record_;
+	record_ = 0;
+	return rec;
+    }
+
+private:
+    const gghtml_params_t &params_;
+    const html_manifest_t &manifest_;
+    const char *template_hash_;
+    cov_file_t *file_;
+    page_record_t *record_;
+};
+
+/*
+ * Lines calculate their counts lazily on first use, and a flow
+ * diagram can show lines from other files, so calculate them all
+ * before the workers start rather than letting them race.
+ */
+static void
+calculate_line_counts()
+{
+    for (list_iterator_t<cov_file_t> iter = cov_file_t::first() ; *iter ; ++iter)
+    {
+	cov_file_t *f = *iter;
+	for (unsigned int lineno = 1 ; lineno <= f->num_lines() ; lineno++)
+	    f->nth_line(lineno)->status();
+    }
+}
+
+static void
+generate_source_pages(const gghtml_params_t &params)
+{
+    html_manifest_t manifest(params.get_output_directory());
+    if (params.get_incremental())
+	manifest.load();
+    string_var template_hash = source_template_hash(params);
+
+    thread_pool_t pool(params.get_jobs());
+    list_t<source_page_job_t> jobs;
+
+    calculate_line_counts();
+    for (list_iterator_t<cov_file_t> iter = cov_file_t::first() ; *iter ; ++iter)
+    {
+	source_page_job_t *job = new source_page_job_t(params, manifest,
+						       template_hash, *iter);
+	jobs.append(job);
+	pool.add(job);
+    }
+    pool.wait();
+
+    for (list_iterator_t<source_page_job_t> iter = jobs.first() ; *iter ; ++iter)
+	manifest.add((*iter)->take_record());
+    jobs.delete_all();
+
+    if (params.get_incremental())
+	manifest.remove_stale();
+    /* saved even without --incremental, for the next incremental run */
+    manifest.save();
+}
+
 static int
 generate_html(const gghtml_params_t &params)
 {
@@ -516,13 +978,7 @@ generate_html(const gghtml_params_t &params)
 	return -1;
     generate_index(params);
     generate_source_tree(params);
-    for (list_iterator_t<cov_file_t> iter = cov_file_t::first() ; *iter ; ++iter)
-    {
-	hashtable_t<void, flow_t> *flows = generate_flow_diagrams(params, *iter);
-	generate_annotated_source(params, *iter, flows);
-	flows->foreach_remove(delete_one_flow, 0);
-	delete flows;
-    }
+    generate_source_pages(params);
     generate_functions(params);
     return 0;
 }
@@ -575,6 +1031,7 @@ main(int argc, char **argv)
     }
     menv.set_template_directory(params.get_template_directory());
     menv.set_output_directory(params.get_output_directory());
+    menv.set_keep_unchanged(params.get_incremental());
 
     int r = cov_read_files(params);
     if (r < 0)
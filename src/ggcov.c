@@ -34,6 +34,7 @@
 #include "functionswin.H"
 #include "fileswin.H"
 #include "reportwin.H"
+#include "cov_watch.H"
 #if HAVE_LIBGNOMEUI
 #include <libgnomeui/libgnomeui.h>
 #endif
@@ -91,6 +92,7 @@ public:
 
     ARGPARSE_STRING_PROPERTY(initial_windows);
     ARGPARSE_BOOL_PROPERTY(profile_mode);
+    ARGPARSE_BOOL_PROPERTY(watch_mode);
 
 protected:
     void setup_parser(argparse::parser_t &parser)
@@ -105,6 +107,9 @@ protected:
               .metavar("WINDOW,...");
 	parser.add_option(0, "profile")
 	      .setter((argparse::noarg_setter_t)&ggcov_params_t::set_profile_mode);
+	parser.add_option(0, "watch")
+	      .description("update the windows when the program writes new counts")
+	      .setter((argparse::noarg_setter_t)&ggcov_params_t::set_watch_mode);
     }
 
     void add_file(const char *file)
@@ -139,7 +144,8 @@ protected:
 
 ggcov_params_t::ggcov_params_t()
  :  initial_windows_("summary"),
-    profile_mode_(FALSE)
+    profile_mode_(FALSE),
+    watch_mode_(FALSE)
 {
 }
 
@@ -436,6 +442,59 @@ ui_create(ggcov_params_t &params, const char *full_argv0, int successes)
     }
 }
 
+/*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
+/*
+ * With --watch, counts written by the program are re-read once its
+ * data files have been quiet for a moment, and the windows update
+ * the rows of the affected files through the files model.
+ */
+
+static cov_watcher_t *watcher;
+static guint watch_timeout;
+
+static gboolean
+on_watch_timeout(gpointer userdata)
+{
+    watch_timeout = 0;
+    if (watcher->has_changes())
+    {
+	list_t<cov_file_t> affected;
+	watcher->reread(affected);
+	_log.info("re-read counts for %u files\n", affected.length());
+	affected.remove_all();
+    }
+    return FALSE;
+}
+
+static gboolean
+on_watch_readable(GIOChannel *chan, GIOCondition cond, gpointer userdata)
+{
+    if (watcher->read_events())
+    {
+	/* a program exiting writes all its data files at once */
+	if (watch_timeout)
+	    g_source_remove(watch_timeout);
+	watch_timeout = g_timeout_add(WATCH_SETTLE_MS, on_watch_timeout, 0);
+    }
+    return TRUE;
+}
+
+static void
+watch_start(void)
+{
+    watcher = new cov_watcher_t;
+    if (!watcher->start())
+    {
+	delete watcher;
+	watcher = 0;
+	return;
+    }
+
+    GIOChannel *chan = g_io_channel_unix_new(watcher->fd());
+    g_io_add_watch(chan, G_IO_IN, on_watch_readable, 0);
+    g_io_channel_unref(chan);
+}
+
 /*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
 
 int
@@ -488,6 +547,8 @@ main(int argc, char **argv)
 
     cov_dump();
     ui_create(params, argv[0], r);
+    if (params.get_watch_mode())
+	watch_start();
     gtk_main();
 
     return 0;
@@ -34,14 +34,26 @@ struct mvc_listener_s
 struct mvc_batch_s
 {
     unsigned int features;
+    gboolean all;               /* some change not described by deltas */
+    unsigned int ndeltas;
+    unsigned int maxdeltas;
+    mvc_delta_t *deltas;
+    GHashTable *index;          /* member -> 1 + index into deltas */
 };
 
+/* a delta which has merged away to nothing, e.g. added then removed */
+#define MVC_NOTHING     ((mvc_delta_type_t)-1)
+
 static GHashTable *listeners;
 static gboolean batching;
 static GHashTable *batch;
 
 static enum { NONE, LISTEN, UNLISTEN, CHANGED, UNBATCH } state = NONE;
 
+/* deltas for the notification currently being dispatched */
+static const mvc_delta_t *current_deltas;
+static unsigned int current_ndeltas;
+
 /*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
 
 void
@@ -133,13 +145,22 @@ mvc_unlisten(void *obj, unsigned int feat, mvc_callback_t proc, void *closure)
 /*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
 
 static void
-mvc_dispatch(void *obj, unsigned int features)
+mvc_dispatch(
+    void *obj,
+    unsigned int features,
+    const mvc_delta_t *deltas,
+    unsigned int ndeltas)
 {
     mvc_listener_t *ml;
+    const mvc_delta_t *saved_deltas = current_deltas;
+    unsigned int saved_ndeltas = current_ndeltas;
 
     if (listeners == 0)
 	return;     /* no listeners on any object */
 
+    current_deltas = deltas;
+    current_ndeltas = ndeltas;
+
     for (ml = (mvc_listener_t *)g_hash_table_lookup(listeners, obj) ;
 	 ml != 0 ;
 	 ml = ml->next)
@@ -147,6 +168,92 @@ mvc_dispatch(void *obj, unsigned int features)
 	if ((ml->features & features))
 	    (*ml->callback)(obj, features, ml->closure);
     }
+
+    current_deltas = saved_deltas;
+    current_ndeltas = saved_ndeltas;
+}
+
+const mvc_delta_t *
+mvc_deltas(unsigned int *ndeltasp)
+{
+    *ndeltasp = current_ndeltas;
+    return current_deltas;
+}
+
+/*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
+
+static mvc_batch_t *
+mvc_find_batch(void *obj, gboolean all)
+{
+    mvc_batch_t *mb;
+
+    if ((mb = (mvc_batch_t *)g_hash_table_lookup(batch, obj)) == 0)
+    {
+	mb = new(mvc_batch_t);
+	g_hash_table_insert(batch, obj, mb);
+    }
+    if (all)
+	mb->all = TRUE;
+    return mb;
+}
+
+static void
+mvc_batch_free(mvc_batch_t *mb)
+{
+    if (mb->index != 0)
+	g_hash_table_destroy(mb->index);
+    g_free(mb->deltas);
+    g_free(mb);
+}
+
+static void
+mvc_batch_add_delta(mvc_batch_t *mb, void *member, mvc_delta_type_t type)
+{
+    mvc_delta_t *d;
+    unsigned int i;
+
+    if (mb->index == 0)
+	mb->index = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+    i = GPOINTER_TO_UINT(g_hash_table_lookup(mb->index, member));
+    if (i != 0)
+    {
+	/* merge with the earlier delta for the same member */
+	d = &mb->deltas[i-1];
+	switch (d->type)
+	{
+	case MVC_ADDED:
+	    if (type == MVC_REMOVED)
+		d->type = MVC_NOTHING;
+	    return;
+	case MVC_CHANGED:
+	    if (type == MVC_REMOVED)
+		d->type = MVC_REMOVED;
+	    return;
+	case MVC_REMOVED:
+	    /*
+	     * The member's address was re-used for a new object.
+	     * Listeners must forget the old one before they see
+	     * the new one, so keep both deltas.
+	     */
+	    if (type != MVC_ADDED)
+		return;
+	    break;
+	default:
+	    d->type = type;
+	    return;
+	}
+    }
+
+    if (mb->ndeltas == mb->maxdeltas)
+    {
+	mb->maxdeltas = (mb->maxdeltas ? 2 * mb->maxdeltas : 16);
+	mb->deltas = g_renew(mvc_delta_t, mb->deltas, mb->maxdeltas);
+    }
+    d = &mb->deltas[mb->ndeltas++];
+    d->member = member;
+    d->type = type;
+    g_hash_table_insert(mb->index, member, GUINT_TO_POINTER(mb->ndeltas));
 }
 
 /*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
@@ -157,24 +264,39 @@ mvc_changed(void *obj, unsigned int features)
 //    assert(state == NONE);
     state = CHANGED;
 
+    if (batching)
+	mvc_find_batch(obj, /*all*/TRUE)->features |= features;
+    else
+	mvc_dispatch(obj, features, 0, 0);
+
+    state = NONE;
+}
+
+void
+mvc_changed_member(
+    void *obj,
+    unsigned int features,
+    void *member,
+    mvc_delta_type_t type)
+{
+//    assert(state == NONE);
+    state = CHANGED;
+
     if (batching)
     {
-	mvc_batch_t *mb;
+	mvc_batch_t *mb = mvc_find_batch(obj, /*all*/FALSE);
 
-	if ((mb = (mvc_batch_t *)g_hash_table_lookup(batch, obj)) == 0)
-	{
-	    mb = new(mvc_batch_t);
-	    mb->features = features;
-	    g_hash_table_insert(batch, obj, mb);
-	}
-	else
-	{
-	    mb->features |= features;
-	}
+	mb->features |= features;
+	if (!mb->all)
+	    mvc_batch_add_delta(mb, member, type);
     }
     else
     {
-	mvc_dispatch(obj, features);
+	mvc_delta_t d;
+
+	d.member = member;
+	d.type = type;
+	mvc_dispatch(obj, features, &d, 1);
     }
 
     state = NONE;
@@ -194,7 +316,7 @@ mvc_deleted(void *obj)
 	    fprintf(stderr, "mvc_deleted: object 0x%p deleted with pending 0x%x\n",
 			obj, mb->features);
 	    g_hash_table_remove(batch, obj);
-	    g_free(mb);
+	    mvc_batch_free(mb);
 	}
     }
     mvc_do_unlisten(obj, /*all*/TRUE, 0, 0, 0);
@@ -220,9 +342,25 @@ mvc_unbatch_1(gpointer key, gpointer value, gpointer user_data)
 {
     void *object = (void *)key;
     mvc_batch_t *mb = (mvc_batch_t *)value;
+    static mvc_delta_t no_deltas[1];
+    unsigned int i, n = 0;
 
-    mvc_dispatch(object, mb->features);
-    g_free(mb);
+    if (mb->all)
+    {
+	mvc_dispatch(object, mb->features, 0, 0);
+    }
+    else
+    {
+	/* squeeze out deltas which merged away */
+	for (i = 0 ; i < mb->ndeltas ; i++)
+	{
+	    if (mb->deltas[i].type != MVC_NOTHING)
+		mb->deltas[n++] = mb->deltas[i];
+	}
+	mvc_dispatch(object, mb->features,
+		     (n ? mb->deltas : no_deltas), n);
+    }
+    mvc_batch_free(mb);
     return TRUE;    /* remove me */
 }
 
@@ -32,6 +32,37 @@ void mvc_unlisten(void *obj, unsigned int features, mvc_callback_t,
 void mvc_changed(void *obj, unsigned int features);
 void mvc_deleted(void *obj);
 
+/*
+ * An object which is a collection of other objects, like the
+ * files model, can say which of its members changed by calling
+ * mvc_changed_member() instead of mvc_changed().  Listeners find
+ * the list of deltas by calling mvc_deltas() during the callback.
+ * It returns NULL when the change is not described by deltas, in
+ * which case the listener should assume everything changed.
+ *
+ * Within a batch, deltas for the same member are merged, e.g. a
+ * member added and then changed is reported only as added, and a
+ * member added and then removed is not reported at all.  A member
+ * removed and then added again is a new object at the same address,
+ * so it's reported as removed and then added.
+ */
+typedef enum
+{
+    MVC_ADDED,
+    MVC_CHANGED,
+    MVC_REMOVED
+} mvc_delta_type_t;
+
+typedef struct
+{
+    void *member;
+    mvc_delta_type_t type;
+} mvc_delta_t;
+
+void mvc_changed_member(void *obj, unsigned int features,
+			void *member, mvc_delta_type_t);
+const mvc_delta_t *mvc_deltas(unsigned int *ndeltasp);
+
 /*
  * Between batch() and unbatch() all changed notifications are
  * queued internally in the mvc module, then emitted in unbatch().
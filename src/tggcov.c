@@ -39,6 +39,8 @@
 #include "callgraph_diagram.H"
 #include "check_scenegen.H"
 #include "logging.H"
+#include "cov_watch.H"
+#include "cov_history.H"
 
 char *argv0;
 static logging::logger_t &_log = logging::find_logger("tggcov");
@@ -60,6 +62,10 @@ public:
     ARGPARSE_BOOL_PROPERTY(check_callgraph_flag);
     ARGPARSE_BOOL_PROPERTY(dump_callgraph_flag);
     ARGPARSE_STRING_PROPERTY(output_filename);
+    ARGPARSE_BOOL_PROPERTY(watch_flag);
+    ARGPARSE_BOOL_PROPERTY(batch_flag);
+    ARGPARSE_STRING_PROPERTY(history);
+    ARGPARSE_STRING_PROPERTY(history_summaries);
 
 public:
     void setup_parser(argparse::parser_t &parser)
@@ -97,6 +103,24 @@ public:
 	      .description("output file for annotation")
 	      .setter((argparse::arg_setter_t)&tggcov_params_t::set_output_filename)
               .metavar("FILE");
+	parser.add_option(0, "watch")
+	      .description("keep running, and when the program writes new counts "
+			   "re-read them and repeat the reports and annotations")
+	      .setter((argparse::noarg_setter_t)&tggcov_params_t::set_watch_flag);
+	parser.add_option(0, "batch")
+	      .description("answer queries for the status of lines in files, "
+			   "one per line of standard input")
+	      .setter((argparse::noarg_setter_t)&tggcov_params_t::set_batch_flag);
+	parser.add_option(0, "history")
+	      .description("summarise the coverage of the lines changed by recent "
+			   "git commits in REVLIST, like git-history-coverage")
+	      .setter((argparse::arg_setter_t)&tggcov_params_t::set_history)
+	      .metavar("REVLIST");
+	parser.add_option(0, "history-summary")
+	      .description("which history summaries to print, of "
+			   "\"overall\", \"author\" and \"commit\"; default all")
+	      .setter((argparse::arg_setter_t)&tggcov_params_t::set_history_summaries)
+	      .metavar("SUMMARY,...");
 	parser.set_other_option_help("[OPTIONS] [executable|source|directory]...");
     }
 
@@ -121,7 +145,9 @@ tggcov_params_t::tggcov_params_t()
    status_flag_(0),
    new_format_flag_(0),
    check_callgraph_flag_(0),
-   dump_callgraph_flag_(0)
+   dump_callgraph_flag_(0),
+   watch_flag_(0),
+   batch_flag_(0)
 {
 }
 
@@ -430,6 +456,173 @@ dump_callgraph(void)
 
 /*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
 
+/*
+ * Answer queries for the status of lines from standard input, so
+ * that scripts like git-history-coverage can read the coverage data
+ * once for many files instead of running tggcov for each one.
+ *
+ * A query is a line containing a filename, optionally followed by a
+ * tab, the first line number, another tab and the last line number.
+ * The answer is one line with the filename, the first and last line
+ * numbers and a string with one character for each line, separated
+ * by tabs.  The characters are the first letter of each status,
+ * i.e. C, P, U, or S, or - for uninstrumented lines.  The string is
+ * ! if the query can't be answered, e.g. the file wasn't read.
+ */
+static const char batch_status_chars[cov::NUM_STATUS+1] = "CPU-S";
+
+static cov_file_t *
+batch_find_file(const char *name)
+{
+    cov_file_t *f = cov_file_t::find(name);
+    if (f == 0 && name[0] != '/')
+	f = cov_file_t::find(file_make_absolute(name));
+    return f;
+}
+
+static void
+batch_query(char *name)
+{
+    unsigned long first = 1;
+    unsigned long last = 0;
+    char *p;
+    cov_file_t *f;
+
+    if ((p = strchr(name, '\t')) != 0)
+    {
+	*p++ = '\0';
+	first = strtoul(p, &p, 10);
+	last = (*p == '\t' ? strtoul(p+1, &p, 10) : 0);
+	if (*p || !first || last < first)
+	{
+	    _log.error("bad line range in query for %s\n", name);
+	    printf("%s\t%lu\t%lu\t!\n", name, first, last);
+	    return;
+	}
+    }
+
+    if ((f = batch_find_file(name)) == 0)
+    {
+	_log.warning("%s: no coverage data read\n", name);
+	printf("%s\t%lu\t%lu\t!\n", name, first, last);
+	return;
+    }
+    if (!last)
+	last = f->num_lines();
+
+    printf("%s\t%lu\t%lu\t", name, first, last);
+    for (unsigned long lineno = first ; lineno <= last ; lineno++)
+	putchar(batch_status_chars[f->nth_line(lineno)->status()]);
+    putchar('\n');
+}
+
+static void
+batch(void)
+{
+    char buf[4096];
+    char *p;
+
+    while ((fgets(buf, sizeof(buf), stdin)) != 0)
+    {
+	/* trim trailing whitespace but not tabs */
+	p = buf+strlen(buf);
+	while (p > buf && isspace(p[-1]) && p[-1] != '\t')
+	    *--p = '\0';
+	if (!buf[0])
+	    continue;	    /* ignore empty lines */
+
+	batch_query(buf);
+	/* answer each query before the next arrives, for coprocesses */
+	fflush(stdout);
+    }
+}
+
+/*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
+
+static void
+history(tggcov_params_t &params)
+{
+    gboolean overall = TRUE, author = TRUE, commit = TRUE;
+
+    if (params.get_history_summaries())
+    {
+	tok_t tok(params.get_history_summaries(), ", ");
+	const char *name;
+
+	overall = author = commit = FALSE;
+	while ((name = tok.next()) != 0)
+	{
+	    if (!strcmp(name, "overall"))
+		overall = TRUE;
+	    else if (!strcmp(name, "author"))
+		author = TRUE;
+	    else if (!strcmp(name, "commit"))
+		commit = TRUE;
+	    else
+		_log.error("unknown history summary \"%s\"\n", name);
+	}
+    }
+
+    cov_history_t hist(params.get_history());
+    if (!hist.read())
+	exit(1);
+
+    printf("==================== INCREMENTAL COVERAGE REPORT ====================\n");
+    if (overall)
+	hist.summarise_overall(stdout);
+    if (author)
+	hist.summarise_by_author(stdout);
+    if (commit)
+	hist.summarise_by_commit(stdout);
+    printf("========================================\n");
+}
+
+/*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
+
+/*
+ * Wait for the program to write new counts, then re-read just
+ * the files which changed and repeat the output for them.
+ */
+static void
+watch(tggcov_params_t &params)
+{
+    cov_watcher_t watcher;
+
+    if (!watcher.start())
+	exit(1);
+    _log.info("Watching for new counts\n");
+
+    for (;;)
+    {
+	if (!watcher.wait(-1))
+	    continue;
+	watcher.read_events();
+	/* a program exiting writes all its data files at once */
+	while (watcher.wait(WATCH_SETTLE_MS))
+	    watcher.read_events();
+	if (!watcher.has_changes())
+	    continue;
+
+	list_t<cov_file_t> affected;
+	watcher.reread(affected);
+	_log.info("Re-read counts for %u files\n", affected.length());
+
+	if (params.get_reports())
+	    report(params);
+	if (params.get_annotate_flag())
+	{
+	    for (list_iterator_t<cov_file_t> iter = affected.first() ; *iter ; ++iter)
+		annotate_file(params, *iter);
+	}
+	if (params.get_dump_callgraph_flag())
+	    dump_callgraph();
+	fflush(stdout);
+	affected.remove_all();
+    }
+}
+
+/*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
+
 static logging::level_t
 log_level(GLogLevelFlags level)
 {
@@ -478,7 +671,7 @@ main(int argc, char **argv)
     int r = cov_read_files(params);
     if (r < 0)
 	exit(1);    /* error message in cov_read_files() */
-    if (r == 0)
+    if (r == 0 && !params.get_history())
 	exit(0);    /* error message in cov_read_files() */
 
     cov_dump();
@@ -491,6 +684,12 @@ main(int argc, char **argv)
 	check_callgraph();
     if (params.get_dump_callgraph_flag())
 	dump_callgraph();
+    if (params.get_history())
+	history(params);
+    if (params.get_batch_flag())
+	batch();
+    if (params.get_watch_flag())
+	watch(params);
 
     return 0;
 }